@@ -0,0 +1,98 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "Interval.h"
+#include "Ray.h"
+#include "Vec3.h"
+
+#include <utility>
+
+// Axis-aligned bounding box, stored as one Interval per axis. Default box is empty (every interval is empty).
+class AABB
+{
+  public:
+    Interval mX, mY, mZ;
+
+    AABB() {}
+
+    AABB(const Interval& x, const Interval& y, const Interval& z) : mX(x), mY(y), mZ(z) {}
+
+    // a and b are treated as opposite corners, so they don't need to be ordered.
+    AABB(const Point3& a, const Point3& b)
+    {
+      mX = Interval(fmin(a[0], b[0]), fmax(a[0], b[0]));
+      mY = Interval(fmin(a[1], b[1]), fmax(a[1], b[1]));
+      mZ = Interval(fmin(a[2], b[2]), fmax(a[2], b[2]));
+    }
+
+    // Tightest box enclosing both boxes.
+    AABB(const AABB& box0, const AABB& box1) : mX(box0.mX, box1.mX), mY(box0.mY, box1.mY), mZ(box0.mZ, box1.mZ) {}
+
+    const Interval& Axis(int n) const
+    {
+      if (n == 1) return mY;
+      if (n == 2) return mZ;
+      return mX;
+    }
+
+    bool IsEmpty() const
+    {
+      return mX.mMin > mX.mMax || mY.mMin > mY.mMax || mZ.mMin > mZ.mMax;
+    }
+
+    Point3 Centroid() const
+    {
+      return Point3(0.5 * (mX.mMin + mX.mMax), 0.5 * (mY.mMin + mY.mMax), 0.5 * (mZ.mMin + mZ.mMax));
+    }
+
+    int LongestAxis() const
+    {
+      if (mX.Size() > mY.Size())
+      {
+        return mX.Size() > mZ.Size() ? 0 : 2;
+      }
+      return mY.Size() > mZ.Size() ? 1 : 2;
+    }
+
+    double SurfaceArea() const
+    {
+      if (IsEmpty())
+      {
+        return 0;
+      }
+      double dx = mX.Size(), dy = mY.Size(), dz = mZ.Size();
+      return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+
+    // Slab test: the ray is inside the box for t in the overlap of the three per-axis [t0, t1] ranges.
+    // If the overlap ever becomes empty, the ray misses.
+    bool Hit(const Ray& r, Interval tInterval) const
+    {
+      Point3 origin = r.GetOrigin();
+      Vec3 direction = r.GetDirection();
+
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        const Interval& slab = Axis(axis);
+        double inverseDirection = 1 / direction[axis];
+
+        double t0 = (slab.mMin - origin[axis]) * inverseDirection;
+        double t1 = (slab.mMax - origin[axis]) * inverseDirection;
+        if (inverseDirection < 0)
+        {
+          std::swap(t0, t1);
+        }
+
+        if (t0 > tInterval.mMin) tInterval.mMin = t0;
+        if (t1 < tInterval.mMax) tInterval.mMax = t1;
+
+        if (tInterval.mMax <= tInterval.mMin)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "BVH.h"
+#include "Camera.h"
+#include "HittableList.h"
+#include "Sphere.h"
+#include "Vec3.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A value at a point in time (in seconds). Between two keyframes the value is linearly interpolated,
+// and before the first/after the last keyframe it is held constant.
+template <typename T>
+struct Keyframe
+{
+    double time;
+    T value;
+};
+
+template <typename T>
+T Lerp(const T& a, const T& b, double fraction)
+{
+    return a + fraction * (b - a);
+}
+
+// Keyframes are expected to be added in increasing time order.
+template <typename T>
+T EvaluateKeyframes(const std::vector<Keyframe<T>>& keyframes, double time)
+{
+    if (time <= keyframes.front().time)
+    {
+      return keyframes.front().value;
+    }
+    for (size_t i = 1; i < keyframes.size(); ++i)
+    {
+      if (time < keyframes[i].time)
+      {
+        const Keyframe<T>& previous = keyframes[i - 1];
+        double fraction = (time - previous.time) / (keyframes[i].time - previous.time);
+        return Lerp(previous.value, keyframes[i].value, fraction);
+      }
+    }
+    return keyframes.back().value;
+}
+
+struct CameraPose
+{
+    Point3 lookFrom;
+    Point3 lookAt;
+    double verticalFOV;
+
+    CameraPose operator+(const CameraPose& other) const { return { lookFrom + other.lookFrom, lookAt + other.lookAt, verticalFOV + other.verticalFOV }; }
+    CameraPose operator-(const CameraPose& other) const { return { lookFrom - other.lookFrom, lookAt - other.lookAt, verticalFOV - other.verticalFOV }; }
+};
+
+inline CameraPose operator*(double t, const CameraPose& pose)
+{
+    return { t * pose.lookFrom, t * pose.lookAt, t * pose.verticalFOV };
+}
+
+// Renders a range of frames of a world whose spheres and camera move along keyframed paths.
+// Only spheres that have keyframes move, everything else in the world is static.
+//
+// Rather than building a new BVH every frame, the BVH from the previous frame is refitted to the new sphere positions.
+// Refitting keeps the old tree shape, which gets worse the more things move, so once the boxes have grown on average
+// past mRebuildGrowthRatio times their size at the last build (see BVH::RefitGrowth) the tree gets rebuilt instead.
+class Animation
+{
+  public:
+    double mFramesPerSecond = 24;
+    int mStartFrame = 0;
+    int mEndFrame = 23;  // Inclusive
+    double mRebuildGrowthRatio = 1.2;
+    std::string mOutputPrefix = "frame_";  // Frame n is written to <mOutputPrefix><n, zero padded to 4 digits>.ppm
+
+    void AddSphereKeyframe(Sphere* sphere, double time, const Point3& center)
+    {
+      for (auto& track : mSphereTracks)
+      {
+        if (track.sphere == sphere)
+        {
+          track.keyframes.push_back({time, center});
+          return;
+        }
+      }
+      mSphereTracks.push_back({sphere, {{time, center}}});
+    }
+
+    void AddCameraKeyframe(double time, const Point3& lookFrom, const Point3& lookAt, double verticalFOV)
+    {
+      mCameraKeyframes.push_back({time, {lookFrom, lookAt, verticalFOV}});
+    }
+
+    // Returns false, after reporting it, if a frame couldn't be written. Rendering stops there, since every later frame goes to the
+    // same place.
+    bool Render(const HittableList& world, Camera& camera)
+    {
+      auto startTime = std::chrono::steady_clock::now();
+      int rebuilds = 0;
+
+      for (int frame = mStartFrame; frame <= mEndFrame; ++frame)
+      {
+        double time = frame / mFramesPerSecond;
+        for (const auto& track : mSphereTracks)
+        {
+          track.sphere->center = EvaluateKeyframes(track.keyframes, time);
+        }
+        if (!mCameraKeyframes.empty())
+        {
+          CameraPose pose = EvaluateKeyframes(mCameraKeyframes, time);
+          camera.mLookFrom = pose.lookFrom;
+          camera.mLookAt = pose.lookAt;
+          camera.mVerticalFOV = pose.verticalFOV;
+        }
+
+        if (frame == mStartFrame)
+        {
+          mBVH.Build(world);
+        }
+        else if (mBVH.RefitOrRebuild(mRebuildGrowthRatio))
+        {
+          ++rebuilds;
+        }
+
+        // Cached lighting from the last frame is wrong once things have moved, and cells stop updating once they're full.
+        if (camera.mRadianceCache)
+        {
+          camera.mRadianceCache->Clear();
+        }
+
+        char frameNumber[16];
+        std::snprintf(frameNumber, sizeof(frameNumber), "%04d", frame);
+        std::string framePath = mOutputPrefix + frameNumber + ".ppm";
+        std::ofstream out(framePath);
+        if (out)  // Don't spend a whole frame's render on a file that can't even be opened
+        {
+          camera.Render(mBVH, out);
+        }
+        if (!out)
+        {
+          std::cerr << "Couldn't write " << framePath << "\n";
+          return false;
+        }
+      }
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+      int frameCount = mEndFrame - mStartFrame + 1;
+      std::cerr << "Rendered " << frameCount << " frames in " << elapsed.count() << "s ("
+                << frameCount * 60.0 / elapsed.count() << " frames per minute, "
+                << rebuilds << " BVH rebuilds)\n";
+      return true;
+    }
+
+  private:
+    struct SphereTrack
+    {
+      Sphere* sphere;
+      std::vector<Keyframe<Point3>> keyframes;
+    };
+
+    std::vector<SphereTrack> mSphereTracks;
+    std::vector<Keyframe<CameraPose>> mCameraKeyframes;
+
+    // Kept across Render() calls so the BVH's allocations get reused from frame to frame.
+    BVH mBVH;
+};
+
+#endif
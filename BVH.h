@@ -0,0 +1,252 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "AABB.h"
+#include "Hittable.h"
+#include "HittableList.h"
+
+#include <algorithm>
+#include <vector>
+
+// Bounding volume hierarchy over the objects of a HittableList, stored as a flat array of nodes.
+// Nodes are laid out in pre-order (a parent always comes before its children), which is what lets
+// Refit() update every box in a single reverse sweep without recursing.
+//
+// The BVH does not own the objects. The list it was built from has to outlive it.
+class BVH : public Hittable
+{
+  public:
+    BVH() {}
+    BVH(const HittableList& list) { Build(list); }
+
+    // Takes the objects out of list and builds a fresh hierarchy over them.
+    void Build(const HittableList& list);
+
+    // Rebuilds the hierarchy over the same objects, e.g. after they have moved too far for Refit() to keep the tree good.
+    // All vectors (including the scratch ones) are cleared rather than freed, so a rebuild after the first one doesn't allocate
+    // unless objects were added.
+    void Rebuild();
+
+    // Keeps the tree topology and only recomputes boxes from the objects' current positions. Much cheaper than Rebuild(),
+    // but the boxes get looser (and traversal slower) the further objects drift from where they were at build time.
+    void Refit();
+
+    // How much looser the boxes have become since the last build: the average, over all nodes, of each node's surface area
+    // now divided by its surface area at build time. 1 means the tree is as tight as when it was built.
+    // Every node counts the same, so one huge object (like the ground sphere) that makes the root box enormous can't hide
+    // small objects drifting apart further down the tree.
+    double RefitGrowth() const;
+
+    // Refits, then rebuilds instead if RefitGrowth() ends up over maxGrowth. Returns true if it rebuilt.
+    bool RefitOrRebuild(double maxGrowth);
+
+    bool Hit(const Ray& r, Interval tInterval, HitRecord& outRecord) const override;
+
+    AABB BoundingBox() const override
+    {
+      return mNodes.empty() ? AABB() : mNodes[0].box;
+    }
+
+  private:
+    // Leaf if objectCount > 0, in which case its objects are mObjects[firstIndex, firstIndex + objectCount).
+    // Otherwise the left child is the next node in the array and firstIndex is the index of the right child.
+    struct Node
+    {
+      AABB box;
+      int firstIndex;
+      int objectCount;
+    };
+
+    static const int sMaxObjectsPerLeaf = 4;
+
+    int BuildRange(int begin, int end);
+
+    std::vector<Node> mNodes;
+    std::vector<const Hittable*> mObjects;
+    std::vector<AABB> mObjectBoxes;  // Parallel to mObjects, only valid while building.
+    std::vector<double> mBuiltAreas;  // Parallel to mNodes, each node's surface area right after the last build.
+    std::vector<int> mOrder;  // Scratch index buffer used to sort objects while building.
+    std::vector<const Hittable*> mSortedObjects;  // Scratch buffer used to reorder mObjects after building.
+};
+
+// The reason why I have implementations here and not in a .cpp file is because it's tedious
+// to keep updating the tasks.json file for the build task to include cpp files.
+// If these files are not included in tasks.json, they will not be picked up.
+void BVH::Build(const HittableList& list)
+{
+    mObjects.clear();
+    for (const auto& hittableObject : list.hittableObjects)
+    {
+      mObjects.push_back(hittableObject.get());
+    }
+    Rebuild();
+}
+
+void BVH::Rebuild()
+{
+    mNodes.clear();
+    mBuiltAreas.clear();
+    mObjectBoxes.clear();
+    mOrder.clear();
+    if (mObjects.empty())
+    {
+      return;
+    }
+
+    for (int i = 0; i < static_cast<int>(mObjects.size()); ++i)
+    {
+      mObjectBoxes.push_back(mObjects[i]->BoundingBox());
+      mOrder.push_back(i);
+    }
+
+    BuildRange(0, static_cast<int>(mOrder.size()));
+
+    // mOrder now holds the leaf order. Permute the objects to match so leaves can index them directly.
+    mSortedObjects.clear();
+    for (size_t i = 0; i < mOrder.size(); ++i)
+    {
+      mSortedObjects.push_back(mObjects[mOrder[i]]);
+    }
+    mObjects.swap(mSortedObjects);
+
+    for (const Node& node : mNodes)
+    {
+      mBuiltAreas.push_back(node.box.SurfaceArea());
+    }
+}
+
+int BVH::BuildRange(int begin, int end)
+{
+    int nodeIndex = static_cast<int>(mNodes.size());
+    mNodes.push_back(Node());
+
+    AABB box;
+    AABB centroidBox;
+    for (int i = begin; i < end; ++i)
+    {
+      const AABB& objectBox = mObjectBoxes[mOrder[i]];
+      box = AABB(box, objectBox);
+      Point3 centroid = objectBox.Centroid();
+      centroidBox = AABB(centroidBox, AABB(centroid, centroid));
+    }
+    mNodes[nodeIndex].box = box;
+
+    int count = end - begin;
+    int axis = centroidBox.LongestAxis();
+    if (count <= sMaxObjectsPerLeaf || centroidBox.Axis(axis).Size() <= 0)
+    {
+      mNodes[nodeIndex].firstIndex = begin;
+      mNodes[nodeIndex].objectCount = count;
+      return nodeIndex;
+    }
+
+    // Median split along the axis the centroids are most spread out on.
+    int middle = begin + count / 2;
+    std::nth_element(mOrder.begin() + begin, mOrder.begin() + middle, mOrder.begin() + end,
+      [this, axis](int a, int b) {
+        return mObjectBoxes[a].Centroid()[axis] < mObjectBoxes[b].Centroid()[axis];
+      });
+
+    BuildRange(begin, middle);  // Left child lands at nodeIndex + 1
+    int rightIndex = BuildRange(middle, end);
+
+    // Don't hold a reference across the recursive calls above, they can reallocate mNodes.
+    mNodes[nodeIndex].firstIndex = rightIndex;
+    mNodes[nodeIndex].objectCount = 0;
+    return nodeIndex;
+}
+
+void BVH::Refit()
+{
+    // Children always sit after their parent, so walking backwards updates children before parents.
+    for (int i = static_cast<int>(mNodes.size()) - 1; i >= 0; --i)
+    {
+      Node& node = mNodes[i];
+      if (node.objectCount > 0)
+      {
+        AABB box;
+        for (int j = node.firstIndex; j < node.firstIndex + node.objectCount; ++j)
+        {
+          box = AABB(box, mObjects[j]->BoundingBox());
+        }
+        node.box = box;
+      }
+      else
+      {
+        node.box = AABB(mNodes[i + 1].box, mNodes[node.firstIndex].box);
+      }
+    }
+}
+
+double BVH::RefitGrowth() const
+{
+    double growthSum = 0;
+    int nodeCount = 0;
+    for (size_t i = 0; i < mNodes.size(); ++i)
+    {
+      // Nodes that were flat or empty at build time have no meaningful ratio.
+      if (mBuiltAreas[i] > 0)
+      {
+        growthSum += mNodes[i].box.SurfaceArea() / mBuiltAreas[i];
+        ++nodeCount;
+      }
+    }
+    return nodeCount > 0 ? growthSum / nodeCount : 1;
+}
+
+bool BVH::RefitOrRebuild(double maxGrowth)
+{
+    Refit();
+    if (RefitGrowth() > maxGrowth)
+    {
+      Rebuild();
+      return true;
+    }
+    return false;
+}
+
+bool BVH::Hit(const Ray& r, Interval tInterval, HitRecord& outRecord) const
+{
+    if (mNodes.empty())
+    {
+      return false;
+    }
+
+    bool hitAnything = false;
+    double closestSoFar = tInterval.mMax;
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+      const Node& node = mNodes[stack[--stackSize]];
+      if (!node.box.Hit(r, Interval(tInterval.mMin, closestSoFar)))
+      {
+        continue;
+      }
+
+      if (node.objectCount > 0)
+      {
+        for (int i = node.firstIndex; i < node.firstIndex + node.objectCount; ++i)
+        {
+          if (mObjects[i]->Hit(r, Interval(tInterval.mMin, closestSoFar), outRecord))
+          {
+            hitAnything = true;
+            closestSoFar = outRecord.t;
+          }
+        }
+      }
+      else
+      {
+        int leftIndex = static_cast<int>(&node - mNodes.data()) + 1;
+        stack[stackSize++] = node.firstIndex;
+        stack[stackSize++] = leftIndex;
+      }
+    }
+
+    return hitAnything;
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include "Camera.h"
+#include "Framebuffer.h"
+#include "Hittable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Renders one world from many cameras (stereo pairs, turntables, ...) in one go. The world is only read while rendering,
+// so all threads share it. Every view is cut into tiles and all tiles of all views go into one queue, so threads never
+// sit idle waiting for the last few tiles of one view while another view still has work.
+//
+// Each view is written to its own file as soon as its last tile is done. Without a radiance cache, each view comes out
+// identical to rendering it on its own. Cameras sharing a cache still work, but then the order tiles finish in shows up
+// in the noise.
+class BatchRenderer
+{
+  public:
+    int mTileSize = 32;
+    int mThreadCount = 0;  // 0 means one per hardware thread
+
+    // Returns false if any view couldn't be written (each one is reported). The other views are still rendered and written.
+    bool Render(const Hittable& world, std::vector<Camera>& cameras, const std::vector<std::string>& outputFiles)
+    {
+      auto startTime = std::chrono::steady_clock::now();
+
+      std::vector<Framebuffer> frames(cameras.size());
+      std::vector<Tile> tiles;
+      for (size_t view = 0; view < cameras.size(); ++view)
+      {
+        cameras[view].PrepareFramebuffer(frames[view]);
+        for (int y = 0; y < frames[view].mHeight; y += mTileSize)
+        {
+          for (int x = 0; x < frames[view].mWidth; x += mTileSize)
+          {
+            tiles.push_back({static_cast<int>(view), x, y});
+          }
+        }
+      }
+
+      // Tiles left per view. Whichever thread finishes a view's last tile writes that view out.
+      std::vector<std::atomic<int>> tilesRemaining(cameras.size());
+      for (const Tile& tile : tiles)
+      {
+        ++tilesRemaining[tile.view];
+      }
+
+      std::atomic<int> failedViews(0);
+      std::atomic<size_t> nextTile(0);
+      auto worker = [&]()
+      {
+        for (size_t t = nextTile++; t < tiles.size(); t = nextTile++)
+        {
+          const Tile& tile = tiles[t];
+          Framebuffer& frame = frames[tile.view];
+          cameras[tile.view].RenderRegion(world, frame, tile.x, tile.y,
+            std::min(tile.x + mTileSize, frame.mWidth), std::min(tile.y + mTileSize, frame.mHeight));
+
+          if (--tilesRemaining[tile.view] == 0)
+          {
+            const Camera& camera = cameras[tile.view];
+            std::ofstream out(outputFiles[tile.view]);
+            frame.Write(out, camera.mImgFormat, camera.mMaxValueForColorChannel, camera.mSamplesPerPixel);
+            if (!out)
+            {
+              ++failedViews;
+              std::cerr << "Couldn't write view " + std::to_string(tile.view) + " to " + outputFiles[tile.view] + "\n";  // One string, so threads' messages don't interleave
+            }
+          }
+        }
+      };
+
+      int threadCount = mThreadCount > 0 ? mThreadCount : std::max(1u, std::thread::hardware_concurrency());
+      std::vector<std::thread> threads;
+      for (int i = 0; i < threadCount; ++i)
+      {
+        threads.emplace_back(worker);
+      }
+      for (std::thread& thread : threads)
+      {
+        thread.join();
+      }
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+      if (failedViews > 0)
+      {
+        std::cerr << failedViews << " of " << cameras.size() << " views couldn't be written\n";
+        return false;
+      }
+      std::cerr << "Rendered " << cameras.size() << " views on " << threadCount << " threads in " << elapsed.count() << "s ("
+                << cameras.size() * 3600.0 / elapsed.count() << " views per hour)\n";
+      return true;
+    }
+
+  private:
+    struct Tile
+    {
+      int view;
+      int x, y;
+    };
+};
+
+#endif
@@ -5,8 +5,15 @@
 #include "Hittable.h"
 #include "Colour.h"
 #include "Material.h"
+#include "Framebuffer.h"
+#include "RadianceCache.h"
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 class Camera
 {
@@ -24,34 +31,116 @@ class Camera
       Point3 mLookFrom = Point3(0, 0, -1);  // Point camera is looking from
       Point3 mLookAt = Point3(0, 0, 0);  // Point camera is looking at
       Vec3 mVecUp = Vec3(0, 1, 0);  // Camera-relative "up" direction
-      
+
+      // Crop window, in pixels of the full mImgWidth x mImgHeight frame. Only this rectangle gets traced and written out,
+      // and its pixels come out identical to the same pixels of a full render (unless mRadianceCache is set, see there).
+      // A width or height of 0 means no crop.
+      int mCropX = 0;
+      int mCropY = 0;
+      int mCropWidth = 0;
+      int mCropHeight = 0;
+
+      unsigned mSeed = 0;  // Together with the pixel position, determines every random number used for that pixel.
+
+      // Optional. When set, diffuse hits from bounce mRadianceCacheBounce onwards (the first hit seen by the camera is bounce 0)
+      // take their incoming light from the cache when it has it, instead of tracing further (apart from the few traced anyway to
+      // refine it, see RadianceCache::mRefineFraction). Bounce 1 reuses the most, but the cache's blurring then shows up directly
+      // in what the camera sees. Bounce 2 hides it behind one more traced diffuse bounce.
+      // With a cache a pixel is no longer a function of just mSeed and its position: it depends on what earlier pixels put in the
+      // cache. So crop windows, previews and multi-view/multi-threaded renders are close to, but not identical to, a full render.
+      // The cache also assumes the scene doesn't change, so clear it whenever objects or lights move.
+      RadianceCache* mRadianceCache = nullptr;
+      int mRadianceCacheBounce = 1;
 
     void Render(const Hittable& world)
+    {
+      Render(world, std::cout);
+    }
+
+    void Render(const Hittable& world, std::ostream& out)
     {
       Initialize();
 
       // Render
-      std::cout << mImgFormat << "\n";
-      std::cout << mImgWidth << " " << mImgHeight << "\n";
-      std::cout << mMaxValueForColorChannel << "\n";
-
-      for (int j = 0; j < mImgHeight; ++j) {
-        std::cerr << "\rScanlines remaining: " << mImgHeight - j << ' ' << std::flush;
-        for (int i = 0; i < mImgWidth; ++i) {
-            Colour pixelColour(0,0,0);
-            for (int sample = 0; sample < mSamplesPerPixel; ++sample)
+      out << mImgFormat << "\n";
+      out << mRenderWidth << " " << mRenderHeight << "\n";
+      out << mMaxValueForColorChannel << "\n";
+
+      for (int j = mRenderY; j < mRenderY + mRenderHeight; ++j) {
+        std::cerr << "\rScanlines remaining: " << mRenderY + mRenderHeight - j << ' ' << std::flush;
+        for (int i = mRenderX; i < mRenderX + mRenderWidth; ++i) {
+            WriteColour(out, RenderPixel(world, i, j), mSamplesPerPixel);
+        }
+      }
+      std::cerr << "\nDone\n";
+    }
+
+    // Same as Render, but into frame (resized to the crop window) instead of straight to a stream.
+    void Render(const Hittable& world, Framebuffer& frame)
+    {
+      PrepareFramebuffer(frame);
+      RenderRegion(world, frame, 0, 0, frame.mWidth, frame.mHeight);
+    }
+
+    // For splitting a render into pieces, e.g. tiles spread over threads. Call PrepareFramebuffer once first, then
+    // RenderRegion can be called for any number of non-overlapping regions, from any thread.
+    void PrepareFramebuffer(Framebuffer& frame)
+    {
+      Initialize();
+      frame.Resize(mRenderWidth, mRenderHeight);
+    }
+
+    // Renders framebuffer pixels [x0, x1) x [y0, y1). These are relative to the crop window, like the framebuffer itself.
+    void RenderRegion(const Hittable& world, Framebuffer& frame, int x0, int y0, int x1, int y1) const
+    {
+      for (int j = y0; j < y1; ++j) {
+        for (int i = x0; i < x1; ++i) {
+            frame.At(i, j) = RenderPixel(world, mRenderX + i, mRenderY + j);
+        }
+      }
+    }
+
+    // Coarse-to-fine preview of the (cropped) frame. Writes <filePrefix>_8.ppm, _4, _2 and _1, at 1/8, 1/4, 1/2 and full
+    // resolution. Level n only traces every nth pixel in each direction, so each level reuses every pixel the coarser levels
+    // already traced, and the full resolution image is exactly what Render would have produced (without a radiance cache).
+    void RenderPreview(const Hittable& world, const std::string& filePrefix)
+    {
+      Initialize();
+
+      Framebuffer frame(mRenderWidth, mRenderHeight);
+      std::vector<char> traced(frame.mPixels.size(), 0);
+      auto startTime = std::chrono::steady_clock::now();
+
+      for (int stride = 8; stride >= 1; stride /= 2)
+      {
+        Framebuffer level((mRenderWidth + stride - 1) / stride, (mRenderHeight + stride - 1) / stride);
+        for (int y = 0; y < level.mHeight; ++y)
+        {
+          for (int x = 0; x < level.mWidth; ++x)
+          {
+            int i = x * stride;
+            int j = y * stride;
+            size_t index = static_cast<size_t>(j) * mRenderWidth + i;
+            if (!traced[index])
             {
-                Ray r = GetRayToShoot(i, j);
-                pixelColour += RayColour(r, world, mMaxRayColourRecursiveDepth);
+              frame.At(i, j) = RenderPixel(world, mRenderX + i, mRenderY + j);
+              traced[index] = 1;
             }
-            WriteColour(std::cout, pixelColour, mSamplesPerPixel);
+            level.At(x, y) = frame.At(i, j);
+          }
         }
+
+        std::ofstream out(filePrefix + "_" + std::to_string(stride) + ".ppm");
+        level.Write(out, mImgFormat, mMaxValueForColorChannel, mSamplesPerPixel);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cerr << "Preview 1/" << stride << " (" << level.mWidth << "x" << level.mHeight << ") ready after " << elapsed.count() << "s\n";
       }
-      std::cerr << "\nDone\n";
     }
 
   private:
     int mImgHeight;
+    int mRenderX, mRenderY, mRenderWidth, mRenderHeight;  // The part of the frame that actually gets rendered (i.e. the crop window, clamped to the frame)
     Point3 mCameraOrigin;
     Vec3 mPixel00Location;  // Center of the upper left pixel
     Vec3 mPixelHorizontalSpacing; // The horizontal and vertical delta vectors from pixel to pixel
@@ -63,6 +152,18 @@ class Camera
       mImgHeight = static_cast<int>(mImgWidth / mAspectRatio);
       mImgHeight = (mImgHeight < 1) ? 1 : mImgHeight;
 
+      mRenderX = 0;
+      mRenderY = 0;
+      mRenderWidth = mImgWidth;
+      mRenderHeight = mImgHeight;
+      if (mCropWidth > 0 && mCropHeight > 0)
+      {
+        mRenderX = std::max(0, std::min(mCropX, mImgWidth - 1));
+        mRenderY = std::max(0, std::min(mCropY, mImgHeight - 1));
+        mRenderWidth = std::min(mCropWidth, mImgWidth - mRenderX);
+        mRenderHeight = std::min(mCropHeight, mImgHeight - mRenderY);
+      }
+
       mCameraOrigin = mLookFrom;
 
       // Viewport dimensions. Viewport is the rectangle that defines our pixels through which we send rays into the scene.
@@ -88,6 +189,21 @@ class Camera
       mPixel00Location = viewportUpperLeftCorner + (mPixelHorizontalSpacing + mPixelVerticalSpacing)/2;
     }
 
+    // Sum of all samples for pixel (i, j) of the full frame. Reseeds the random generator first, so the result only depends
+    // on mSeed and (i, j), no matter what order pixels are rendered in.
+    Colour RenderPixel(const Hittable& world, int i, int j) const
+    {
+      SeedRandom(MixBits((static_cast<uint64_t>(mSeed) << 32) ^ (static_cast<uint64_t>(j) * mImgWidth + i)));
+
+      Colour pixelColour(0,0,0);
+      for (int sample = 0; sample < mSamplesPerPixel; ++sample)
+      {
+          Ray r = GetRayToShoot(i, j);
+          pixelColour += RayColour(r, world, mMaxRayColourRecursiveDepth);
+      }
+      return pixelColour;
+    }
+
     Ray GetRayToShoot(int i, int j) const
     {
        Point3 pixelCenter = mPixel00Location + (i * mPixelHorizontalSpacing) + (j * mPixelVerticalSpacing);
@@ -121,6 +237,22 @@ class Camera
           Colour attenuation;
           if (rec.material->Scatter(r, rec, attenuation, scattered))
           {
+            int bounce = mMaxRayColourRecursiveDepth - recursiveDepthLimit;
+            if (mRadianceCache && bounce >= mRadianceCacheBounce && rec.material->IsDiffuse())
+            {
+              Colour incoming;
+              bool cached = mRadianceCache->Lookup(rec.hitPoint, rec.normal, incoming);
+              if (!cached || RandomDouble0To1() < mRadianceCache->mRefineFraction)
+              {
+                Colour traced = RayColour(scattered, world, recursiveDepthLimit - 1);
+                mRadianceCache->Insert(rec.hitPoint, rec.normal, traced);
+                if (!cached)
+                {
+                  incoming = traced;
+                }
+              }
+              return attenuation * incoming;
+            }
             return attenuation * RayColour(scattered, world, recursiveDepthLimit - 1);
           }
           // If scattering doesn't happen, that means the ray is absorbed. Return black.
@@ -0,0 +1,104 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "Colour.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Image held in memory, for when pixels can't just be streamed out in scanline order.
+// Pixels hold the un-averaged sum of their samples, same as what gets passed to WriteColour.
+class Framebuffer
+{
+  public:
+    Framebuffer() {}
+    Framebuffer(int width, int height) { Resize(width, height); }
+
+    void Resize(int width, int height)
+    {
+      mWidth = width;
+      mHeight = height;
+      mPixels.assign(static_cast<size_t>(width) * height, Colour(0, 0, 0));
+    }
+
+    Colour& At(int i, int j) { return mPixels[static_cast<size_t>(j) * mWidth + i]; }
+    const Colour& At(int i, int j) const { return mPixels[static_cast<size_t>(j) * mWidth + i]; }
+
+    void Write(std::ostream& out, const std::string& imgFormat, int maxValueForColorChannel, int samplesPerPixel) const
+    {
+      out << imgFormat << "\n";
+      out << mWidth << " " << mHeight << "\n";
+      out << maxValueForColorChannel << "\n";
+      for (const Colour& pixelColour : mPixels)
+      {
+        WriteColour(out, pixelColour, samplesPerPixel);
+      }
+    }
+
+    int mWidth = 0;
+    int mHeight = 0;
+    std::vector<Colour> mPixels;
+};
+
+// Reads a P3 image like the ones Write produces. Since written pixels are gamma corrected and rounded down to integers, the
+// pixels read back are only approximately the original ones: each becomes the middle of its rounding step, back in linear
+// space, as a single sample. Returns false if the stream isn't a P3 image.
+bool ReadPPM(std::istream& in, Framebuffer& outFrame)
+{
+    std::string imgFormat;
+    int width, height, maxValueForColorChannel;
+    if (!(in >> imgFormat >> width >> height >> maxValueForColorChannel) || imgFormat != "P3" || width <= 0 || height <= 0)
+    {
+      return false;
+    }
+
+    outFrame.Resize(width, height);
+    for (Colour& pixelColour : outFrame.mPixels)
+    {
+      for (int channel = 0; channel < 3; ++channel)
+      {
+        int value;
+        if (!(in >> value))
+        {
+          return false;
+        }
+        double gammaCorrected = fmin((value + 0.5) / COLOUR_MULT_FACTOR, 1.0);
+        pixelColour[channel] = gammaCorrected * gammaCorrected;  // Undo the sqrt in WriteColour
+      }
+    }
+    return true;
+}
+
+// Per channel error of an image against a reference, in linear colour (i.e. before gamma correction).
+struct ImageDifference
+{
+    Colour rootMeanSquareError;
+    Colour meanBias;  // Mean of (image - reference). Positive means the image is brighter than the reference.
+
+    double AverageRootMeanSquareError() const
+    {
+      return (rootMeanSquareError.X() + rootMeanSquareError.Y() + rootMeanSquareError.Z()) / 3;
+    }
+};
+
+// Both images must be the same size. The sample counts are needed because framebuffers hold sums of samples.
+ImageDifference CompareImages(const Framebuffer& image, int samplesPerPixel, const Framebuffer& reference, int referenceSamplesPerPixel)
+{
+    Colour squaredErrorSum(0, 0, 0);
+    Colour errorSum(0, 0, 0);
+    for (size_t i = 0; i < image.mPixels.size(); ++i)
+    {
+      Colour error = image.mPixels[i] / samplesPerPixel - reference.mPixels[i] / referenceSamplesPerPixel;
+      squaredErrorSum += error * error;
+      errorSum += error;
+    }
+
+    double pixelCount = static_cast<double>(image.mPixels.size());
+    ImageDifference difference;
+    difference.rootMeanSquareError = Colour(sqrt(squaredErrorSum.X() / pixelCount), sqrt(squaredErrorSum.Y() / pixelCount), sqrt(squaredErrorSum.Z() / pixelCount));
+    difference.meanBias = errorSum / pixelCount;
+    return difference;
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "Ray.h"
 #include "Interval.h"
+#include "AABB.h"
 
 class Material;
 class HitRecord
@@ -12,7 +13,7 @@ class HitRecord
     Vec3 normal;
     double t;
     bool frontFace;  // True if the ray is hitting the outer face of the sphere, false if ray is "inside" sphere and hitting the inner face.
-    shared_ptr<Material> material;
+    const Material* material;  // Non-owning. Hit records are copied around a lot, and copying a shared_ptr means an atomic refcount update every time.
 
     void SetFaceAndNormal(const Ray& r, const Vec3& outwardNormal)
     {
@@ -29,7 +30,12 @@ class HitRecord
 class Hittable
 {
   public:
+    virtual ~Hittable() = default;
+
     virtual bool Hit(const Ray& r, Interval tInterval, HitRecord& record) const = 0;
+
+    // Box enclosing the object as it is right now. Objects can move between frames, so callers shouldn't cache this.
+    virtual AABB BoundingBox() const = 0;
 };
 
 #endif
\ No newline at end of file
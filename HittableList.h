@@ -15,12 +15,22 @@ class HittableList : public Hittable
     HittableList() {}
     HittableList(shared_ptr<Hittable> hittableObject) { Add(hittableObject); }
 
-    void Clear() { hittableObjects.clear(); }
+    void Clear() { hittableObjects.clear(); materials.clear(); }
     void Add(shared_ptr<Hittable> hittableObject) { hittableObjects.push_back(hittableObject); }
+    // Non-owning add, for objects that live in a SceneArena. Uses shared_ptr's aliasing constructor with an empty owner,
+    // so there's no control block allocation and no reference counting. The caller keeps the object alive.
+    void Add(Hittable* hittableObject) { hittableObjects.push_back(shared_ptr<Hittable>(shared_ptr<Hittable>(), hittableObject)); }
+
+    // Objects only point at their materials, so the list owns them instead. Returns the pointer to hand to the objects.
+    // Keeping the owning pointers here rather than in every object keeps the objects themselves small.
+    const Material* AddMaterial(shared_ptr<Material> material) { materials.push_back(material); return material.get(); }
 
     bool Hit(const Ray& r, Interval tInterval, HitRecord& record) const override;
 
+    AABB BoundingBox() const override;
+
     std::vector<shared_ptr<Hittable>> hittableObjects;
+    std::vector<shared_ptr<Material>> materials;
 };
 
 // The reason why I have implementations here and not in a .cpp file is because it's tedious 
@@ -45,4 +55,14 @@ bool HittableList::Hit(const Ray& r, Interval tInterval, HitRecord& outRecord) c
 
     return hitAnything;
 }
+
+AABB HittableList::BoundingBox() const
+{
+    AABB box;
+    for (const auto& hittableObject : hittableObjects)
+    {
+      box = AABB(box, hittableObject->BoundingBox());
+    }
+    return box;
+}
 #endif
\ No newline at end of file
@@ -12,6 +12,14 @@ class Interval
 
     Interval(double _min, double _max) : mMin(_min), mMax(_max) {}
 
+    // Tightest interval enclosing both a and b.
+    Interval(const Interval& a, const Interval& b) : mMin(fmin(a.mMin, b.mMin)), mMax(fmax(a.mMax, b.mMax)) {}
+
+    double Size() const
+    {
+      return mMax - mMin;
+    }
+
     bool Contains(double x) const
     {
       return mMin <= x && mMax >= x;
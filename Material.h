@@ -12,6 +12,9 @@ class Material
     virtual ~Material() = default;
 
     virtual bool Scatter(const Ray& incomingRay, const HitRecord& record, Colour& outAttenuation, Ray& outScattered) const = 0;
+
+    // True if the light scattered off this material doesn't depend on the incoming direction (so it can be cached in a RadianceCache).
+    virtual bool IsDiffuse() const { return false; }
 };
 
 // Recall: Lambertian materials are diffuse, meaning they scatter at many angles (typical of rough surfaces).
@@ -37,6 +40,8 @@ class Lambertian : public Material
       return true;
     }
 
+    bool IsDiffuse() const override { return true; }
+
     Colour mAttenuation;
 };
 
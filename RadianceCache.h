@@ -0,0 +1,117 @@
+#ifndef RADIANCE_CACHE_H
+#define RADIANCE_CACHE_H
+
+#include "Colour.h"
+#include "Utils.h"
+#include "Vec3.h"
+
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// World-space cache of the light arriving at diffuse surfaces, stored in a hashed grid.
+//
+// For a Lambertian surface the light it bounces towards the camera is attenuation * (average light arriving over the
+// hemisphere around the normal), and that average doesn't depend on where the ray came from. It's also smooth across the
+// surface, so nearby hit points can share it. Each grid cell (position + rough normal direction) keeps a running average
+// of the traced values, and once a cell has mMinSamples of them, lookups can return the average instead of tracing further.
+// The caller should still trace (and Insert) mRefineFraction of the lookups that hit, so a cell's average keeps improving
+// as the render goes on, instead of its first mMinSamples samples' noise getting baked in.
+//
+// Lookups don't just return the cell the point is in: the point is first moved by a random offset of up to half a cell along
+// the surface. Which neighbouring cell that lands in is then random, with the same weights bilinear interpolation between
+// cell centers would use, so on average a lookup is that interpolation and lighting doesn't step at cell boundaries. The
+// extra noise averages out over a pixel's samples like any other. Across the normal, and between normal directions, there is
+// no interpolation: on a curved surface the cache can still show faint seams where the normal crosses into another bucket.
+//
+// The knobs trade bias for speed: bigger cells and fewer required samples mean more reuse, but blurrier lighting
+// (and, for very few samples, blotchy noise in the first samples of the render). A lower mRefineFraction is faster, but
+// cells converge more slowly.
+//
+// Safe to Lookup/Insert from many threads at once. Cells are spread over independently locked shards so that threads
+// rarely wait on each other.
+class RadianceCache
+{
+  public:
+    double mCellSize = 0.2;
+    int mMinSamples = 16;
+    double mRefineFraction = 0.125;
+
+    bool Lookup(const Point3& point, const Vec3& normal, Colour& outRadiance) const
+    {
+      // Any two directions at right angles to the normal will do for moving along the surface.
+      Vec3 tangent = UnitVector(Cross(fabs(normal.X()) > 0.9 ? Vec3(0, 1, 0) : Vec3(1, 0, 0), normal));
+      Vec3 bitangent = Cross(normal, tangent);
+      Point3 jittered = point + mCellSize * (RandomDouble(-0.5, 0.5) * tangent + RandomDouble(-0.5, 0.5) * bitangent);
+
+      uint64_t key = Key(jittered, normal);
+      const Shard& shard = mShards[key % sShardCount];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      auto it = shard.records.find(key);
+      if (it == shard.records.end() || it->second.count < mMinSamples)
+      {
+        return false;
+      }
+      outRadiance = it->second.sum / it->second.count;
+      return true;
+    }
+
+    void Insert(const Point3& point, const Vec3& normal, const Colour& radiance)
+    {
+      uint64_t key = Key(point, normal);
+      Shard& shard = mShards[key % sShardCount];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      Record& record = shard.records[key];
+      record.sum += radiance;
+      ++record.count;
+    }
+
+    void Clear()
+    {
+      for (Shard& shard : mShards)
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.records.clear();
+      }
+    }
+
+  private:
+    struct Record
+    {
+      Colour sum;
+      int count = 0;
+    };
+
+    struct Shard
+    {
+      mutable std::mutex mutex;
+      std::unordered_map<uint64_t, Record> records;
+    };
+
+    static const int sShardCount = 64;
+
+    // Packs the grid cell (17 bits per axis, wrapping around) and the normal (each component bucketed into 5 steps) into one
+    // key, then scrambles it so that neighbouring cells land in different shards.
+    uint64_t Key(const Point3& point, const Vec3& normal) const
+    {
+      uint64_t key = 0;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        int64_t cell = static_cast<int64_t>(std::floor(point[axis] / mCellSize));
+        key = (key << 17) | (static_cast<uint64_t>(cell) & 0x1FFFF);
+      }
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        int bucket = static_cast<int>(std::floor((normal[axis] + 1) * 2));  // normal is a unit vector, so 0 to 4
+        key = key * 5 + bucket;
+      }
+      return MixBits(key);
+    }
+
+    Shard mShards[sShardCount];
+};
+
+#endif
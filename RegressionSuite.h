@@ -0,0 +1,337 @@
+#ifndef REGRESSION_SUITE_H
+#define REGRESSION_SUITE_H
+
+#include "BVH.h"
+#include "Animation.h"
+#include "Camera.h"
+#include "RadianceCache.h"
+#include "Framebuffer.h"
+#include "HittableList.h"
+#include "Material.h"
+#include "Sphere.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// A small scene that exercises one part of the renderer. Seeds are fixed, so it renders the same way every time.
+struct RegressionScene
+{
+    RegressionScene(const std::string& name, const Camera& camera) : name(name), camera(camera) {}
+
+    std::string name;
+    HittableList world;
+    Camera camera;
+    std::string referenceName;  // Compare against this scene's reference image instead of one of its own. Empty means its own.
+    shared_ptr<RadianceCache> radianceCache;  // Optional, cleared before every render.
+};
+
+std::vector<RegressionScene> MakeRegressionScenes()
+{
+    std::vector<RegressionScene> scenes;
+
+    Camera camera;
+    // Enough work that each render takes a second or more, so timer noise is small next to the timing limits.
+    camera.mImgWidth = 160;
+    camera.mSamplesPerPixel = 1024;
+    camera.mVerticalFOV = 40;
+    camera.mLookFrom = Point3(0, 1, 3);
+    camera.mLookAt = Point3(0, 0.3, -1);
+    camera.mSeed = 31;
+
+    auto materialGround = make_shared<Lambertian>(Colour(0.5, 0.5, 0.5));
+
+    {
+      RegressionScene scene("lambertian", camera);
+      scene.world.Add(make_shared<Sphere>(Point3(0, -100.5, -1), 100, scene.world.AddMaterial(materialGround)));
+      scene.world.Add(make_shared<Sphere>(Point3(0, 0, -1), 0.5, scene.world.AddMaterial(make_shared<Lambertian>(Colour(0.1, 0.2, 0.5)))));
+      scenes.push_back(scene);
+
+      // Same scene through the radiance cache, which has to stay within the bias limit of the plain path traced image.
+      scene.name = "lambertian-radiance-cache";
+      scene.referenceName = "lambertian";
+      scene.radianceCache = make_shared<RadianceCache>();
+      scene.camera.mRadianceCache = scene.radianceCache.get();
+      scenes.push_back(scene);
+    }
+
+    {
+      RegressionScene scene("metal", camera);
+      scene.world.Add(make_shared<Sphere>(Point3(0, -100.5, -1), 100, scene.world.AddMaterial(materialGround)));
+      scene.world.Add(make_shared<Sphere>(Point3(-0.6, 0, -1), 0.5, scene.world.AddMaterial(make_shared<Metal>(Colour(0.8, 0.8, 0.8), 0.0))));
+      scene.world.Add(make_shared<Sphere>(Point3(0.6, 0, -1), 0.5, scene.world.AddMaterial(make_shared<Metal>(Colour(0.8, 0.6, 0.2), 0.4))));
+      scenes.push_back(scene);
+    }
+
+    {
+      // Glass ball, and a hollow glass bubble (a negative radius sphere inside a positive one, sec 11.5).
+      RegressionScene scene("dielectric", camera);
+      auto materialGlass = scene.world.AddMaterial(make_shared<Dielectric>(1.5));
+      scene.world.Add(make_shared<Sphere>(Point3(0, -100.5, -1), 100, scene.world.AddMaterial(materialGround)));
+      scene.world.Add(make_shared<Sphere>(Point3(-0.6, 0, -1), 0.5, materialGlass));
+      scene.world.Add(make_shared<Sphere>(Point3(0.6, 0, -1), 0.5, materialGlass));
+      scene.world.Add(make_shared<Sphere>(Point3(0.6, 0, -1), -0.4, materialGlass));
+      scene.world.Add(make_shared<Sphere>(Point3(0, 0, -2.5), 0.5, scene.world.AddMaterial(make_shared<Lambertian>(Colour(0.7, 0.2, 0.1)))));
+      scenes.push_back(scene);
+    }
+
+    {
+      // Two almost perfect mirrors facing each other, so rays bounce back and forth until the depth limit.
+      RegressionScene scene("deep-recursion", camera);
+      auto materialMirror = scene.world.AddMaterial(make_shared<Metal>(Colour(0.95, 0.95, 0.95), 0.0));
+      scene.world.Add(make_shared<Sphere>(Point3(0, 0, -1003), 1000, materialMirror));
+      scene.world.Add(make_shared<Sphere>(Point3(0, 0, 1005), 1000, materialMirror));
+      scene.world.Add(make_shared<Sphere>(Point3(0, 0, -1), 0.5, scene.world.AddMaterial(make_shared<Lambertian>(Colour(0.2, 0.6, 0.2)))));
+      scene.camera.mLookFrom = Point3(0.3, 0.2, 2);
+      scene.camera.mLookAt = Point3(0, 0, -1);
+      scene.camera.mMaxRayColourRecursiveDepth = 200;
+      scene.camera.mSamplesPerPixel = 128;  // Every sample bounces up to 200 times, so this is already the slowest scene
+      scenes.push_back(scene);
+    }
+
+    return scenes;
+}
+
+// Renders every regression scene through a BVH (like every real render) and checks it against the reference image
+// <mDirectory>/<name>.ppm and the timing baseline in <mDirectory>/timings.txt. mUpdateImages/mUpdateTimings write new
+// references/baselines instead. The reference images only depend on the fixed seeds, so they're checked in. Timings depend
+// on the machine, so they aren't: a CI job has to record them on its own runner first (--update-timings), then check with
+// mRequireTimings set, which fails any scene that has no baseline. Without it, such scenes only get a warning.
+//
+// Images are compared statistically rather than exactly, so that a change to e.g. the random number generator (which
+// changes the noise but not the picture) still passes. A scene fails if any channel's RMSE or mean bias against the
+// reference is over the limit. Both limits are set just above what an unchanged picture measures:
+// - Same seed, so the only difference is rounding the reference to 8 bits: RMSE 0.0012-0.0021, |bias| up to 2.4e-4.
+// - Different seed (fresh noise in the render): RMSE up to 0.0039, |bias| up to 2.4e-4.
+// The radiance cache scene is within the same numbers, so it doesn't get looser limits. Measured breakages, all of which fail:
+// - Metal without fuzz:                      metal      RMSE 0.0135, |bias| 6.8e-4
+// - Metal with half the fuzz:                metal      RMSE 0.0084, |bias| 5.3e-4
+// - Dielectric without Schlick reflection:   dielectric RMSE 0.0195, |bias| 1.6e-3
+// - Sphere normal ignoring negative radius:  dielectric RMSE 0.085,  |bias| 2.6e-3
+// Bias is the more telling one for changes to the whole picture (noise averages out over the image, a darker or brighter
+// picture doesn't), RMSE for ones that only move light around, like blurrier reflections. A scene also fails if it renders
+// more than mMaxSlowdown slower than its baseline.
+class RegressionSuite
+{
+  public:
+    std::string mDirectory = "golden";
+    bool mUpdateImages = false;
+    bool mUpdateTimings = false;
+    bool mRequireTimings = false;
+    double mMaxRootMeanSquareError = 0.005;
+    double mMaxMeanBias = 0.001;
+    double mMaxSlowdown = 0.2;  // Fraction, so 0.2 means fail when more than 20% slower
+    double mTimingSlack = 0.05;  // Seconds allowed on top of mMaxSlowdown, so scheduler hiccups on short scenes don't fail them
+    int mTimingRuns = 3;  // The median of this many renders is the scene's time, to filter out noise from the rest of the machine
+
+    // Returns true if every scene passed.
+    bool Run()
+    {
+      std::map<std::string, double> baselines = ReadTimings();
+      std::map<std::string, double> timings;
+      bool allPassed = true;
+      int untimedScenes = 0;
+
+      for (RegressionScene& scene : MakeRegressionScenes())
+      {
+        BVH bvh(scene.world);
+        Framebuffer frame;
+        std::vector<double> runTimes;
+        for (int run = 0; run < mTimingRuns; ++run)
+        {
+          if (scene.radianceCache)
+          {
+            scene.radianceCache->Clear();
+          }
+          auto startTime = std::chrono::steady_clock::now();
+          scene.camera.Render(bvh, frame);
+          std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+          runTimes.push_back(elapsed.count());
+        }
+        std::sort(runTimes.begin(), runTimes.end());
+        double seconds = runTimes[runTimes.size() / 2];
+        timings[scene.name] = seconds;
+
+        std::string imagePath = mDirectory + "/" + (scene.referenceName.empty() ? scene.name : scene.referenceName) + ".ppm";
+        if (mUpdateImages && scene.referenceName.empty())
+        {
+          std::ofstream out(imagePath);
+          frame.Write(out, scene.camera.mImgFormat, scene.camera.mMaxValueForColorChannel, scene.camera.mSamplesPerPixel);
+          if (!out)
+          {
+            std::cerr << scene.name << ": couldn't write " << imagePath << " (does the directory exist?)\n";
+            return false;
+          }
+          std::cerr << scene.name << ": wrote " << imagePath << "\n";
+        }
+        if (mUpdateImages || mUpdateTimings)
+        {
+          continue;
+        }
+
+        bool imagePassed = CheckImage(scene, frame, imagePath);
+        untimedScenes += baselines.count(scene.name) == 0;
+        bool timingPassed = CheckTiming(scene.name, seconds, baselines);
+        bool passed = imagePassed && timingPassed;
+        std::cerr << scene.name << ": " << (passed ? "PASS" : "FAIL") << "\n";
+        allPassed = allPassed && passed;
+      }
+
+      if (!mUpdateImages && !mUpdateTimings)
+      {
+        bool passed = CheckBVHRefit();
+        std::cerr << "bvh-refit: " << (passed ? "PASS" : "FAIL") << "\n";
+        allPassed = allPassed && passed;
+      }
+
+      // Repeated at the end so it can't scroll by unnoticed: a passing run without baselines says nothing about speed.
+      if (untimedScenes > 0)
+      {
+        std::cerr << "WARNING: " << untimedScenes << " scenes had no timing baseline, so "
+                  << (mRequireTimings ? "they failed" : "slowdowns can't fail this run (use --require-timings in CI)") << "\n";
+      }
+
+      if (mUpdateTimings)
+      {
+        std::ofstream out(mDirectory + "/timings.txt");
+        for (const auto& timing : timings)
+        {
+          out << timing.first << " " << timing.second << "\n";
+        }
+        if (!out)
+        {
+          std::cerr << "Couldn't write " << mDirectory << "/timings.txt (does the directory exist?)\n";
+          return false;
+        }
+        std::cerr << "Wrote " << mDirectory << "/timings.txt\n";
+      }
+      return allPassed;
+    }
+
+  private:
+    // A ground sphere plus a grid of small spheres. Nudging a few small spheres should keep the refitted tree, scattering all of
+    // them should make BVH::RefitOrRebuild rebuild (the ground sphere's huge box mustn't hide that), and the BVH has to agree
+    // with the plain list about what a ray hits either way.
+    bool CheckBVHRefit() const
+    {
+      const double maxGrowth = Animation().mRebuildGrowthRatio;
+      SeedRandom(31);
+
+      HittableList world;
+      auto material = world.AddMaterial(make_shared<Lambertian>(Colour(0.5, 0.5, 0.5)));
+      world.Add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, material));
+      std::vector<Sphere*> smallSpheres;
+      for (int i = -20; i < 20; i++)
+      {
+        for (int j = -20; j < 20; j++)
+        {
+          auto sphere = make_shared<Sphere>(Point3(i, 0.2, j), 0.2, material);
+          smallSpheres.push_back(sphere.get());
+          world.Add(sphere);
+        }
+      }
+      BVH bvh(world);
+
+      for (int i = 0; i < 3; ++i)
+      {
+        smallSpheres[i]->center += Vec3(0.1, 0, 0);
+      }
+      if (bvh.RefitOrRebuild(maxGrowth))
+      {
+        std::cerr << "  rebuilt after a small move (growth " << bvh.RefitGrowth() << ")\n";
+        return false;
+      }
+      if (!SameHits(world, bvh))
+      {
+        return false;
+      }
+
+      for (Sphere* sphere : smallSpheres)
+      {
+        sphere->center += RandomVector(-3, 3);
+      }
+      if (!bvh.RefitOrRebuild(maxGrowth))
+      {
+        std::cerr << "  didn't rebuild after scattering every sphere (growth " << bvh.RefitGrowth() << ")\n";
+        return false;
+      }
+      return SameHits(world, bvh);
+    }
+
+    static bool SameHits(const HittableList& world, const BVH& bvh)
+    {
+      for (int i = 0; i < 10000; ++i)
+      {
+        Ray r(Point3(13, 2, 3), RandomVector(-1, 1));
+        HitRecord listRecord, bvhRecord;
+        bool listHit = world.Hit(r, Interval(0.001, infinity), listRecord);
+        bool bvhHit = bvh.Hit(r, Interval(0.001, infinity), bvhRecord);
+        if (listHit != bvhHit || (listHit && listRecord.t != bvhRecord.t))
+        {
+          std::cerr << "  BVH and list disagree on a hit\n";
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool CheckImage(const RegressionScene& scene, const Framebuffer& frame, const std::string& imagePath) const
+    {
+      std::ifstream in(imagePath);
+      Framebuffer reference;
+      if (!ReadPPM(in, reference))
+      {
+        std::cerr << "  missing or unreadable reference image " << imagePath << "\n";
+        return false;
+      }
+      if (reference.mWidth != frame.mWidth || reference.mHeight != frame.mHeight)
+      {
+        std::cerr << "  reference image is " << reference.mWidth << "x" << reference.mHeight
+                  << " but render is " << frame.mWidth << "x" << frame.mHeight << "\n";
+        return false;
+      }
+
+      ImageDifference difference = CompareImages(frame, scene.camera.mSamplesPerPixel, reference, 1);
+      std::cerr << "  RMSE " << difference.rootMeanSquareError << "  mean bias " << difference.meanBias;  // Vec3's << ends the line
+      for (int channel = 0; channel < 3; ++channel)
+      {
+        if (difference.rootMeanSquareError[channel] > mMaxRootMeanSquareError || fabs(difference.meanBias[channel]) > mMaxMeanBias)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool CheckTiming(const std::string& name, double seconds, const std::map<std::string, double>& baselines) const
+    {
+      auto baseline = baselines.find(name);
+      if (baseline == baselines.end())
+      {
+        std::cerr << "  " << seconds << "s, " << (mRequireTimings ? "no timing baseline in " : "WARNING: no timing baseline, so speed isn't checked, in ")
+                  << mDirectory << "/timings.txt (record one on this machine with --update-timings)\n";
+        return !mRequireTimings;
+      }
+      std::cerr << "  " << seconds << "s, baseline " << baseline->second << "s\n";
+      return seconds <= baseline->second * (1 + mMaxSlowdown) + mTimingSlack;
+    }
+
+    std::map<std::string, double> ReadTimings() const
+    {
+      std::map<std::string, double> timings;
+      std::ifstream in(mDirectory + "/timings.txt");
+      std::string name;
+      double seconds;
+      while (in >> name >> seconds)
+      {
+        timings[name] = seconds;
+      }
+      return timings;
+    }
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef SCENE_ARENA_H
+#define SCENE_ARENA_H
+
+#include "Hittable.h"
+#include "Material.h"
+#include "Sphere.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Whether the arena can skip running T's destructor. Scene types are polymorphic, and a virtual destructor is never "trivial"
+// as far as the standard library is concerned, even when it has nothing to do. The types below only hold plain values and
+// non-owning pointers, so their destructors really are no-ops. Give any new scene type that is the same a specialization
+// here, otherwise the arena will (correctly, but slowly) record and call its destructor.
+template <typename T> struct SkipArenaDestructor : std::is_trivially_destructible<T> {};
+template <> struct SkipArenaDestructor<Sphere> : std::true_type {};
+template <> struct SkipArenaDestructor<Lambertian> : std::true_type {};
+template <> struct SkipArenaDestructor<Metal> : std::true_type {};
+template <> struct SkipArenaDestructor<Dielectric> : std::true_type {};
+
+// Bump allocator. Objects are placement-new'd one after another into big blocks, and everything is released at once
+// when the arena is cleared or destroyed. There is no way to free a single object.
+class Arena
+{
+  public:
+    Arena(size_t blockSize = 1 << 20) : mBlockSize(blockSize) {}
+    ~Arena() { Clear(); }
+
+    // Objects hand out raw pointers into the blocks, so the arena can't be copied or moved out from under them.
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template <typename T, typename... Args>
+    T* Make(Args&&... args)
+    {
+      T* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      // Objects whose destructor does nothing (every scene type so far) aren't tracked at all, so releasing them is just freeing blocks.
+      if (!SkipArenaDestructor<T>::value)
+      {
+        mDestructors.push_back({object, [](void* p) { static_cast<T*>(p)->~T(); }});
+      }
+      return object;
+    }
+
+    // Destroys every object (in reverse order of creation) and frees all blocks.
+    void Clear()
+    {
+      for (auto it = mDestructors.rbegin(); it != mDestructors.rend(); ++it)
+      {
+        it->destroy(it->object);
+      }
+      mDestructors.clear();
+
+      for (char* block : mBlocks)
+      {
+        ::operator delete(block);
+      }
+      mBlocks.clear();
+      mCurrent = nullptr;
+      mRemaining = 0;
+      mBytesUsed = 0;
+    }
+
+    size_t BytesUsed() const { return mBytesUsed; }
+
+  private:
+    struct Destructor
+    {
+      void* object;
+      void (*destroy)(void*);
+    };
+
+    void* Allocate(size_t size, size_t alignment)
+    {
+      size_t padding = (alignment - reinterpret_cast<size_t>(mCurrent) % alignment) % alignment;
+      if (mCurrent == nullptr || padding + size > mRemaining)
+      {
+        // operator new returns memory aligned for any fundamental type, so a fresh block needs no padding.
+        size_t blockSize = std::max(mBlockSize, size);
+        mCurrent = static_cast<char*>(::operator new(blockSize));
+        mBlocks.push_back(mCurrent);
+        mRemaining = blockSize;
+        padding = 0;
+      }
+
+      char* result = mCurrent + padding;
+      mCurrent = result + size;
+      mRemaining -= padding + size;
+      mBytesUsed += size;
+      return result;
+    }
+
+    size_t mBlockSize;
+    std::vector<char*> mBlocks;
+    char* mCurrent = nullptr;
+    size_t mRemaining = 0;
+    size_t mBytesUsed = 0;
+    std::vector<Destructor> mDestructors;
+};
+
+// Storage for a whole scene. Primitives and materials live in separate arenas so that primitives end up packed
+// next to each other in memory (which is what traversal walks over), instead of interleaved with their materials.
+//
+// Make() returns non-owning pointers that stay valid until the SceneArena is cleared or destroyed, so the SceneArena
+// has to outlive any HittableList/BVH that refers to its objects.
+class SceneArena
+{
+  public:
+    template <typename T, typename... Args>
+    T* Make(Args&&... args)
+    {
+      Arena& arena = std::is_base_of<Hittable, T>::value ? mPrimitives : mMaterials;
+      return arena.Make<T>(std::forward<Args>(args)...);
+    }
+
+    void Clear()
+    {
+      mPrimitives.Clear();
+      mMaterials.Clear();
+    }
+
+    size_t BytesUsed() const { return mPrimitives.BytesUsed() + mMaterials.BytesUsed(); }
+
+  private:
+    Arena mPrimitives;
+    Arena mMaterials;
+};
+
+#endif
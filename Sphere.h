@@ -26,13 +26,21 @@ class Sphere : public Hittable
   public:
     Sphere() {}
     // center is not a Point3& so we can instantialize shared pointers with rvalues
-    Sphere(Point3 center, double r, shared_ptr<Material> material) : center(center), radius(r), material(material) {};
+    // The sphere doesn't own its material, something else has to keep it alive (HittableList::AddMaterial or a SceneArena).
+    Sphere(Point3 center, double r, const Material* material) : center(center), radius(r), material(material) {};
 
     bool Hit(const Ray& r, Interval tInterval, HitRecord& outRecord) const override;
 
+    AABB BoundingBox() const override
+    {
+      // fabs because of the negative radius trick for hollow spheres (sec 11.5)
+      Vec3 radiusVec(fabs(radius), fabs(radius), fabs(radius));
+      return AABB(center - radiusVec, center + radiusVec);
+    }
+
     Point3 center;
     double radius;
-    shared_ptr<Material> material;
+    const Material* material;
 };
 
 // The reason why I have implementations here and not in a .cpp file is because it's tedious 
@@ -2,9 +2,9 @@
 #define UTILS_H
 
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <memory>
-#include <random>
 
 
 // Usings
@@ -24,10 +24,35 @@ inline double DegreesToRadians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+// splitmix64 finalizer. Turns nearby inputs (like neighbouring pixel indices) into unrelated-looking seeds.
+inline uint64_t MixBits(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// The generator is splitmix64: a counter that steps by a fixed odd constant, run through MixBits. Its whole state is one
+// 64-bit number, so reseeding it (which the camera does for every pixel) costs nothing, unlike std::mt19937 with its 2.5KB
+// of state to refill. Every thread gets its own state, so rendering threads never share (or fight over) random state.
+inline uint64_t& RandomState() {
+    thread_local uint64_t state = 0;
+    return state;
+}
+
+// Restarts the calling thread's random sequence. The camera does this per pixel so that a pixel's samples only depend
+// on the seed and the pixel's position, not on which pixels happened to be rendered before it.
+inline void SeedRandom(uint64_t seed) {
+    RandomState() = seed;
+}
+
 inline double RandomDouble0To1() {
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
+    // MixBits adds the step itself, so passing the old state and storing the stepped one is exactly splitmix64.
+    uint64_t& state = RandomState();
+    uint64_t bits = MixBits(state);
+    state += 0x9E3779B97F4A7C15ull;
+    // Top 53 bits -> a double in [0, 1)
+    return (bits >> 11) * (1.0 / 9007199254740992.0);
 }
 inline double RandomDouble(double min, double max)
 {
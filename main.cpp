@@ -1,72 +1,351 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include "Animation.h"
+#include "BatchRenderer.h"
+#include "BVH.h"
 #include "Camera.h"
 #include "Colour.h"
 #include "Ray.h"
 #include "Vec3.h"
+#include "SceneArena.h"
 #include "Sphere.h"
 #include "Hittable.h"
 #include "HittableList.h"
 #include "Utils.h"
 #include "Material.h"
+#include "RadianceCache.h"
+#include "RegressionSuite.h"
 
-int main() 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Peak resident set size of the process so far, in megabytes. 0 where we don't know how to ask the OS.
+double PeakRSSInMB()
+{
+#if defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / (1024.0 * 1024.0);  // Bytes on macOS
+#elif defined(__unix__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;  // Kilobytes on Linux
+#else
+    return 0;
+#endif
+}
+
+// The scene can be built in two layouts: the original one, where every sphere and material is its own make_shared
+// allocation (materials owned by the world), or packed into a SceneArena when one is passed in.
+template <typename T, typename... Args>
+const Material* MakeMaterial(HittableList& world, SceneArena* arena, Args&&... args)
+{
+    if (arena)
+    {
+        return arena->Make<T>(std::forward<Args>(args)...);
+    }
+    return world.AddMaterial(make_shared<T>(std::forward<Args>(args)...));
+}
+
+Sphere* AddSphere(HittableList& world, SceneArena* arena, const Point3& center, double radius, const Material* material)
+{
+    if (arena)
+    {
+        Sphere* sphere = arena->Make<Sphere>(center, radius, material);
+        world.Add(sphere);
+        return sphere;
+    }
+    auto sphere = make_shared<Sphere>(center, radius, material);
+    world.Add(sphere);
+    return sphere.get();
+}
+
+// Ground, a (2 * gridHalfExtent)^2 grid of small random spheres, and three large spheres (returned in largeSpheres so they can be animated).
+void BuildRandomScene(HittableList& world, SceneArena* arena, int gridHalfExtent, Sphere* largeSpheres[3])
 {
-    // World
-    HittableList world;
-    
     // Materials
-    auto materialGround = make_shared<Lambertian>(Colour(0.5, 0.5, 0.5));
-    // auto materialCenter = make_shared<Lambertian>(Colour(0.1, 0.2, 0.5)); 
+    auto materialGround = MakeMaterial<Lambertian>(world, arena, Colour(0.5, 0.5, 0.5));
+    // auto materialCenter = make_shared<Lambertian>(Colour(0.1, 0.2, 0.5));
     // auto materialLeft = make_shared<Dielectric>(1.5); // 1.5 is the index of refraction for glass.
     // auto materialRight = make_shared<Metal>(Colour(0.8, 0.6, 0.2), 0.0);
 
-    world.Add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, materialGround));  // This is the "ground", a sphere so large that it serves as earth lol
+    AddSphere(world, arena, Point3(0, -1000, 0), 1000, materialGround);  // This is the "ground", a sphere so large that it serves as earth lol
     // world.Add(make_shared<Sphere>(Point3(0, 0, -1), 0.5, materialCenter));
     // world.Add(make_shared<Sphere>(Point3(-1, 0, -1), 0.5, materialLeft));
     // world.Add(make_shared<Sphere>(Point3(-1, 0, -1), -0.4, materialLeft));
     // world.Add(make_shared<Sphere>(Point3(1, 0, -1), 0.5, materialRight));
 
-    for (int i = -11; i < 11; i++)
+    for (int i = -gridHalfExtent; i < gridHalfExtent; i++)
     {
-        for (int j = -11; j < 11; j++)
+        for (int j = -gridHalfExtent; j < gridHalfExtent; j++)
         {
             double chooseMaterial = RandomDouble0To1();
             Point3 center(i + 0.9 * RandomDouble0To1(), 0.2, j + 0.9 * RandomDouble0To1());
 
             if ((center - Point3(4, 0.2, 0)).Length() > 0.9)
             {
-                shared_ptr<Material> sphereMaterial;
+                const Material* sphereMaterial;
 
                 if (chooseMaterial < 0.8)
                 {
                     // Diffuse
                     Colour attenuation = RandomVector() * RandomVector();
-                    sphereMaterial = make_shared<Lambertian>(attenuation);
+                    sphereMaterial = MakeMaterial<Lambertian>(world, arena, attenuation);
                 }
                 else if (chooseMaterial < 0.95)
                 {
                     // Metal
                     Colour attenuation = RandomVector(0.5, 1);
                     double fuzz = RandomDouble(0, 0.5);
-                    sphereMaterial = make_shared<Metal>(attenuation, fuzz);
+                    sphereMaterial = MakeMaterial<Metal>(world, arena, attenuation, fuzz);
                 } else
                 {
                     // Glass
-                    sphereMaterial = make_shared<Dielectric>(1.5);
+                    sphereMaterial = MakeMaterial<Dielectric>(world, arena, 1.5);
                 }
-                world.Add(make_shared<Sphere>(center, 0.2, sphereMaterial));
+                AddSphere(world, arena, center, 0.2, sphereMaterial);
             }
         }
     }
 
-    auto materialLargeSphere1 = make_shared<Dielectric>(1.5);
-    world.Add(make_shared<Sphere>(Point3(0, 1, 0), 1.0, materialLargeSphere1));
+    auto materialLargeSphere1 = MakeMaterial<Dielectric>(world, arena, 1.5);
+    largeSpheres[0] = AddSphere(world, arena, Point3(0, 1, 0), 1.0, materialLargeSphere1);
+
+    auto materialLargeSphere2 = MakeMaterial<Lambertian>(world, arena, Colour(0.4, 0.2, 0.1));
+    largeSpheres[1] = AddSphere(world, arena, Point3(-4, 1, 0), 1.0, materialLargeSphere2);
+
+    auto materialLargeSphere3 = MakeMaterial<Metal>(world, arena, Colour(0.7, 0.6, 0.5), 0.0);
+    largeSpheres[2] = AddSphere(world, arena, Point3(4, 1, 0), 1.0, materialLargeSphere3);
+}
+
+// Renders a small version of the frame with plain path tracing and with a radiance cache (a fresh one with the knobs of
+// settings for every render) at increasing sample counts,
+// and prints how long each took and how far it is (RMSE, and mean bias, which is what the cache costs) from a high sample
+// count reference. Then, for every cached render, estimates how long plain path tracing takes to reach the same RMSE, by
+// interpolating between the path traced renders on a log-log scale (error falls off as a power of time).
+void RunRadianceCacheBenchmark(const Hittable& world, Camera camera, const RadianceCache& settings)
+{
+    const int referenceSamplesPerPixel = 1024;
+    camera.mImgWidth = 200;
+    camera.mSamplesPerPixel = referenceSamplesPerPixel;
+    camera.mRadianceCache = nullptr;
+
+    Framebuffer reference;
+    auto referenceStart = std::chrono::steady_clock::now();
+    camera.Render(world, reference);
+    std::chrono::duration<double> referenceTime = std::chrono::steady_clock::now() - referenceStart;
+    std::cerr << "Reference: " << referenceSamplesPerPixel << " spp in " << referenceTime.count() << "s\n";
+
+    // Different seed so the reference's noise doesn't line up with (and flatter) the test renders. Path tracing and the cache
+    // take turns at each sample count, and each time is the median of a few renders, so the machine getting busier or quieter
+    // halfway through doesn't favour either.
+    camera.mSeed = 1;
+    const int timingRuns = 3;
+    std::vector<double> times[2], errors[2];
+    for (int samplesPerPixel = 4; samplesPerPixel <= 128; samplesPerPixel *= 2)
+    {
+        for (int useCache = 0; useCache <= 1; ++useCache)
+        {
+            camera.mSamplesPerPixel = samplesPerPixel;
+            Framebuffer frame;
+            std::vector<double> runTimes;
+            for (int run = 0; run < timingRuns; ++run)
+            {
+                RadianceCache cache;
+                cache.mCellSize = settings.mCellSize;
+                cache.mMinSamples = settings.mMinSamples;
+                cache.mRefineFraction = settings.mRefineFraction;
+                camera.mRadianceCache = useCache ? &cache : nullptr;
+
+                auto start = std::chrono::steady_clock::now();
+                camera.Render(world, frame);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                runTimes.push_back(elapsed.count());
+            }
+            std::sort(runTimes.begin(), runTimes.end());
+            double seconds = runTimes[timingRuns / 2];
+
+            ImageDifference difference = CompareImages(frame, samplesPerPixel, reference, referenceSamplesPerPixel);
+            times[useCache].push_back(seconds);
+            errors[useCache].push_back(difference.AverageRootMeanSquareError());
+            std::cerr << (useCache ? "Radiance cache: " : "Path tracing:   ") << samplesPerPixel << " spp in " << seconds
+                      << "s, RMSE " << difference.AverageRootMeanSquareError() << ", mean bias " << difference.meanBias;
+        }
+    }
+
+    std::cerr << "Time to equal error (cell size " << settings.mCellSize << ", min samples " << settings.mMinSamples
+              << ", refine fraction " << settings.mRefineFraction << ", bounce " << camera.mRadianceCacheBounce << "):\n";
+    const std::vector<double>& pathTimes = times[0];
+    const std::vector<double>& pathErrors = errors[0];
+    for (size_t i = 0; i < times[1].size(); ++i)
+    {
+        double targetError = errors[1][i];
+        std::cerr << "  RMSE " << targetError << ": cache " << times[1][i] << "s, path tracing ";
+
+        size_t k = 1;
+        while (k < pathErrors.size() && pathErrors[k] > targetError)
+        {
+            ++k;
+        }
+        if (targetError > pathErrors.front() || k == pathErrors.size())
+        {
+            std::cerr << "out of the measured range\n";
+            continue;
+        }
+        double fraction = (log(targetError) - log(pathErrors[k - 1])) / (log(pathErrors[k]) - log(pathErrors[k - 1]));
+        double pathTime = exp(log(pathTimes[k - 1]) + fraction * (log(pathTimes[k]) - log(pathTimes[k - 1])));
+        std::cerr << pathTime << "s (" << pathTime / times[1][i] << "x)\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // Usage: main [--animate <startFrame> <endFrame>] [--preview] [--crop <x> <y> <width> <height>] [--arena] [--scene-size <gridHalfExtent>] [--radiance-cache] [--cache-benchmark]
+    //            [--cache-cell-size <size>] [--cache-min-samples <count>] [--cache-refine-fraction <fraction>] [--cache-bounce <bounce>]
+    //            [--views <viewsFile>] [--threads <count>] [--regression <directory>] [--update-golden] [--update-timings]
+    //            [--require-timings] [--max-slowdown <fraction>]
+    // Without arguments, renders a single frame to stdout. With --animate, renders the frame range to frame_XXXX.ppm files.
+    // --preview renders coarse-to-fine previews to preview_8.ppm, preview_4.ppm, preview_2.ppm and preview_1.ppm instead.
+    // --crop only renders that rectangle of the frame.
+    // --arena packs the scene into a SceneArena instead of allocating every object separately.
+    // --scene-size sets how many small spheres there are: (2 * gridHalfExtent)^2, default 11.
+    // --radiance-cache caches indirect diffuse lighting (see RadianceCache.h). --cache-benchmark compares that against plain path tracing.
+    //   --cache-cell-size, --cache-min-samples, --cache-refine-fraction and --cache-bounce set RadianceCache::mCellSize,
+    //   RadianceCache::mMinSamples, RadianceCache::mRefineFraction and Camera::mRadianceCacheBounce, trading bias for speed.
+    // --views renders every view listed in viewsFile in one go, sharing the scene (see BatchRenderer.h). Each line of the file is
+    //   lookFromX lookFromY lookFromZ lookAtX lookAtY lookAtZ verticalFOV outputFile
+    // Blank lines and lines starting with # are skipped. --threads sets how many threads that uses (default: all of them).
+    // --regression renders the small scenes in RegressionSuite.h and checks them against the reference images and timing baselines
+    //   in directory (golden/ in the repo), exiting with 1 if anything fails. --update-golden writes new reference images and timing
+    //   baselines there instead, --update-timings only the baselines (which depend on the machine, so they aren't checked in).
+    //   A scene without a baseline only gets a warning, unless --require-timings is given, which fails it. So CI has to run
+    //   --update-timings on the runner first (e.g. on the base commit), then --regression with --require-timings.
+    //   --max-slowdown is how much slower than the baseline a scene may get, default 0.2 (20%).
+    bool animate = false;
+    int startFrame = 0;
+    int endFrame = 0;
+    bool preview = false;
+    int crop[4] = {0, 0, 0, 0};
+    bool useArena = false;
+    int gridHalfExtent = 11;
+    bool useRadianceCache = false;
+    bool cacheBenchmark = false;
+    RadianceCache radianceCache;
+    int radianceCacheBounce = 1;
+    std::string viewsFile;
+    int threadCount = 0;
+    RegressionSuite regressionSuite;
+    bool runRegressionSuite = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--animate" && i + 2 < argc)
+        {
+            animate = true;
+            startFrame = std::atoi(argv[++i]);
+            endFrame = std::atoi(argv[++i]);
+        }
+        else if (arg == "--preview")
+        {
+            preview = true;
+        }
+        else if (arg == "--crop" && i + 4 < argc)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                crop[k] = std::atoi(argv[++i]);
+            }
+        }
+        else if (arg == "--radiance-cache")
+        {
+            useRadianceCache = true;
+        }
+        else if (arg == "--cache-benchmark")
+        {
+            cacheBenchmark = true;
+        }
+        else if (arg == "--cache-cell-size" && i + 1 < argc)
+        {
+            radianceCache.mCellSize = std::atof(argv[++i]);
+        }
+        else if (arg == "--cache-min-samples" && i + 1 < argc)
+        {
+            radianceCache.mMinSamples = std::atoi(argv[++i]);
+        }
+        else if (arg == "--cache-refine-fraction" && i + 1 < argc)
+        {
+            radianceCache.mRefineFraction = std::atof(argv[++i]);
+        }
+        else if (arg == "--cache-bounce" && i + 1 < argc)
+        {
+            radianceCacheBounce = std::atoi(argv[++i]);
+        }
+        else if (arg == "--views" && i + 1 < argc)
+        {
+            viewsFile = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threadCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "--regression" && i + 1 < argc)
+        {
+            runRegressionSuite = true;
+            regressionSuite.mDirectory = argv[++i];
+        }
+        else if (arg == "--update-golden")
+        {
+            regressionSuite.mUpdateImages = true;
+            regressionSuite.mUpdateTimings = true;
+        }
+        else if (arg == "--update-timings")
+        {
+            regressionSuite.mUpdateTimings = true;
+        }
+        else if (arg == "--require-timings")
+        {
+            regressionSuite.mRequireTimings = true;
+        }
+        else if (arg == "--max-slowdown" && i + 1 < argc)
+        {
+            regressionSuite.mMaxSlowdown = std::atof(argv[++i]);
+        }
+        else if (arg == "--arena")
+        {
+            useArena = true;
+        }
+        else if (arg == "--scene-size" && i + 1 < argc)
+        {
+            gridHalfExtent = std::atoi(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+            return 1;
+        }
+    }
 
-    auto materialLargeSphere2 = make_shared<Lambertian>(Colour(0.4, 0.2, 0.1));
-    world.Add(make_shared<Sphere>(Point3(-4, 1, 0), 1.0, materialLargeSphere2));
+    if (runRegressionSuite)
+    {
+        return regressionSuite.Run() ? 0 : 1;
+    }
 
-    auto materialLargeSphere3 = make_shared<Metal>(Colour(0.7, 0.6, 0.5), 0.0);
-    world.Add(make_shared<Sphere>(Point3(4, 1, 0), 1.0, materialLargeSphere3));
+    // World
+    auto buildStart = std::chrono::steady_clock::now();
+    SceneArena arena;
+    HittableList world;
+    Sphere* largeSpheres[3];
+    BuildRandomScene(world, useArena ? &arena : nullptr, gridHalfExtent, largeSpheres);
+    std::chrono::duration<double> buildTime = std::chrono::steady_clock::now() - buildStart;
+    std::cerr << "Built scene of " << world.hittableObjects.size() << " objects (" << (useArena ? "arena" : "make_shared")
+              << ") in " << buildTime.count() << "s\n";
 
     // Camera - x points left/right, y points up/down, z points in/out.
     // Recall that z is -1 because of the right hand rule: y is vertical, x is horizontal, so z goes towards the camera.
@@ -78,9 +357,92 @@ int main()
     camera.mLookFrom = Point3(13, 2, 3);
     camera.mLookAt = Point3(0, 0, 0);
     camera.mVecUp = Vec3(0, 1, 0);
+    camera.mCropX = crop[0];
+    camera.mCropY = crop[1];
+    camera.mCropWidth = crop[2];
+    camera.mCropHeight = crop[3];
 
-    camera.Render(world);
-}
+    camera.mRadianceCacheBounce = radianceCacheBounce;
+    if (useRadianceCache)
+    {
+        camera.mRadianceCache = &radianceCache;
+    }
 
+    if (!viewsFile.empty())
+    {
+        std::ifstream views(viewsFile);
+        if (!views)
+        {
+            std::cerr << "Can't open views file " << viewsFile << "\n";
+            return 1;
+        }
 
+        std::vector<Camera> cameras;
+        std::vector<std::string> outputFiles;
+        std::string line;
+        while (std::getline(views, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::istringstream fields(line);
+            Camera view = camera;
+            std::string outputFile;
+            if (!(fields >> view.mLookFrom[0] >> view.mLookFrom[1] >> view.mLookFrom[2]
+                         >> view.mLookAt[0] >> view.mLookAt[1] >> view.mLookAt[2]
+                         >> view.mVerticalFOV >> outputFile))
+            {
+                std::cerr << "Bad line in views file: " << line << "\n";
+                return 1;
+            }
+            cameras.push_back(view);
+            outputFiles.push_back(outputFile);
+        }
 
+        BatchRenderer batchRenderer;
+        batchRenderer.mThreadCount = threadCount;
+        return batchRenderer.Render(BVH(world), cameras, outputFiles) ? 0 : 1;
+    }
+
+    if (cacheBenchmark)
+    {
+        RunRadianceCacheBenchmark(BVH(world), camera, radianceCache);
+        return 0;
+    }
+
+    if (animate)
+    {
+        // Sequence benchmark: the three large spheres bounce/slide over one second while the camera slowly orbits. Everything else stays put.
+        Animation animation;
+        animation.mStartFrame = startFrame;
+        animation.mEndFrame = endFrame;
+
+        animation.AddSphereKeyframe(largeSpheres[0], 0.0, Point3(0, 1, 0));
+        animation.AddSphereKeyframe(largeSpheres[0], 0.5, Point3(0, 2, 0));
+        animation.AddSphereKeyframe(largeSpheres[0], 1.0, Point3(0, 1, 0));
+
+        animation.AddSphereKeyframe(largeSpheres[1], 0.0, Point3(-4, 1, 0));
+        animation.AddSphereKeyframe(largeSpheres[1], 1.0, Point3(-4, 1, 2));
+
+        animation.AddSphereKeyframe(largeSpheres[2], 0.0, Point3(4, 1, 0));
+        animation.AddSphereKeyframe(largeSpheres[2], 1.0, Point3(4, 1, -2));
+
+        animation.AddCameraKeyframe(0.0, Point3(13, 2, 3), Point3(0, 0, 0), 20);
+        animation.AddCameraKeyframe(1.0, Point3(12, 2, 6), Point3(0, 0.5, 0), 20);
+
+        return animation.Render(world, camera) ? 0 : 1;
+    }
+
+    auto renderStart = std::chrono::steady_clock::now();
+    if (preview)
+    {
+        camera.RenderPreview(BVH(world), "preview");
+    }
+    else
+    {
+        camera.Render(BVH(world));
+    }
+    std::chrono::duration<double> renderTime = std::chrono::steady_clock::now() - renderStart;
+    std::cerr << "Rendered in " << renderTime.count() << "s, peak RSS " << PeakRSSInMB() << " MB\n";
+}